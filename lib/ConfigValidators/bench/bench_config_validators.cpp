@@ -0,0 +1,117 @@
+/**
+ * 配置校验/解析基准测试（Google Benchmark）
+ * 对比原实现（legacy）与查表实现的单次调用耗时，并统计每次调用的堆分配次数（allocs）。
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include "ConfigValidators.h"
+#include "LegacyValidators.h"
+
+// 统计堆分配次数
+static size_t g_alloc_count = 0;
+
+void* operator new(size_t size) {
+  g_alloc_count++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const char* UID = "98873b5ca43046cea88fa3b9ed51ef9b";
+static const char* TOPIC = "switch001";
+static const char* MAC = "78:81:8c:05:0f:fa";
+static const char* HEX_DATA = "0201061BFF53050100037E0566200001810917158C81780F00000000000000";
+
+// 固件中参数以 String 形式到达，legacy 版本每次都要构造字符串
+template <typename Fn>
+static void runCounted(benchmark::State& state, Fn fn) {
+  size_t start = g_alloc_count;
+  for (auto _ : state) {
+    fn();
+  }
+  state.counters["allocs"] = benchmark::Counter(
+      (double)(g_alloc_count - start), benchmark::Counter::kAvgIterations);
+}
+
+static void BM_LegacyValidateBafaUID(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(legacyValidateBafaUID(std::string(UID))); });
+}
+BENCHMARK(BM_LegacyValidateBafaUID);
+
+static void BM_CheckBafaUID(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(checkBafaUID(UID, strlen(UID))); });
+}
+BENCHMARK(BM_CheckBafaUID);
+
+static void BM_LegacyValidateBafaTopic(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(legacyValidateBafaTopic(std::string(TOPIC))); });
+}
+BENCHMARK(BM_LegacyValidateBafaTopic);
+
+static void BM_CheckBafaTopic(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(checkBafaTopic(TOPIC, strlen(TOPIC))); });
+}
+BENCHMARK(BM_CheckBafaTopic);
+
+static void BM_LegacyValidateMACAddress(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(legacyValidateMACAddress(std::string(MAC))); });
+}
+BENCHMARK(BM_LegacyValidateMACAddress);
+
+static void BM_CheckMACAddress(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(checkMACAddress(MAC, strlen(MAC), NULL)); });
+}
+BENCHMARK(BM_CheckMACAddress);
+
+static void BM_LegacyParseMAC(benchmark::State& state) {
+  runCounted(state, [] {
+    uint8_t out[6];
+    benchmark::DoNotOptimize(legacyParseMAC(MAC, out));
+    benchmark::DoNotOptimize(out);
+  });
+}
+BENCHMARK(BM_LegacyParseMAC);
+
+static void BM_ParseMACAddress(benchmark::State& state) {
+  runCounted(state, [] {
+    uint8_t out[6];
+    benchmark::DoNotOptimize(parseMACAddress(MAC, strlen(MAC), out));
+    benchmark::DoNotOptimize(out);
+  });
+}
+BENCHMARK(BM_ParseMACAddress);
+
+static void BM_LegacyValidateHexData(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(legacyValidateHexData(std::string(HEX_DATA))); });
+}
+BENCHMARK(BM_LegacyValidateHexData);
+
+static void BM_CheckHexData(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(checkHexData(HEX_DATA, strlen(HEX_DATA), NULL)); });
+}
+BENCHMARK(BM_CheckHexData);
+
+static void BM_LegacyHexToBytes(benchmark::State& state) {
+  runCounted(state, [] { benchmark::DoNotOptimize(legacyHexToBytes(std::string(HEX_DATA))); });
+}
+BENCHMARK(BM_LegacyHexToBytes);
+
+static void BM_DecodeHexData(benchmark::State& state) {
+  runCounted(state, [] {
+    uint8_t out[HEX_DATA_MAX_BYTES];
+    benchmark::DoNotOptimize(decodeHexData(HEX_DATA, strlen(HEX_DATA), out, sizeof(out)));
+    benchmark::DoNotOptimize(out);
+  });
+}
+BENCHMARK(BM_DecodeHexData);
+
+BENCHMARK_MAIN();
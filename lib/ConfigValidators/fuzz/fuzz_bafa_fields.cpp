@@ -0,0 +1,20 @@
+/**
+ * Bafa UID / Topic 校验差分模糊测试（libFuzzer）
+ * 查表实现的接受/拒绝结果必须与原实现一致。
+ */
+
+#include <stdlib.h>
+#include <string>
+
+#include "ConfigValidators.h"
+#include "LegacyValidators.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  const char* text = (const char*)data;
+  std::string legacy(text, size);
+
+  if ((checkBafaUID(text, size) == CONFIG_OK) != legacyValidateBafaUID(legacy)) abort();
+  if ((checkBafaTopic(text, size) == CONFIG_OK) != legacyValidateBafaTopic(legacy)) abort();
+
+  return 0;
+}
@@ -0,0 +1,37 @@
+/**
+ * BLE 广播数据校验与解码差分模糊测试（libFuzzer）
+ * - 接受/拒绝结果必须与原实现一致
+ * - 合法数据的解码结果必须与原 hexToBytes() 一致
+ * - 含非法字符或奇数长度的数据必须解码失败（原实现会静默转成 0）
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "ConfigValidators.h"
+#include "LegacyValidators.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  const char* text = (const char*)data;
+  std::string legacy(text, size);
+
+  size_t bad_pos = 0;
+  ConfigError err = checkHexData(text, size, &bad_pos);
+  bool valid = (err == CONFIG_OK);
+  if (valid != legacyValidateHexData(legacy)) abort();
+  if (err == CONFIG_ERR_HEX_CHAR && (bad_pos >= size || HEX_DIGIT_VALUE[data[bad_pos]] >= 0)) abort();
+
+  uint8_t out[HEX_DATA_MAX_BYTES];
+  int n = decodeHexData(text, size, out, sizeof(out));
+
+  if (valid) {
+    std::string expected = legacyHexToBytes(legacy);
+    if (n < 0 || (size_t)n != expected.size()) abort();
+    if (memcmp(out, expected.data(), n) != 0) abort();
+  } else if (err == CONFIG_ERR_ODD_LENGTH || err == CONFIG_ERR_HEX_CHAR) {
+    if (n != -1) abort();
+  }
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * BLE MAC 地址校验与解析差分模糊测试（libFuzzer）
+ * - 接受/拒绝结果必须与原实现一致
+ * - 合法地址的解析结果必须与 initBLE() 原来的 sscanf 一致，非法地址不得修改输出
+ * - 推导出的基础 MAC 经 ESP-IDF 的 +2 规则后必须还原为原地址
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "ConfigValidators.h"
+#include "LegacyValidators.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  const char* text = (const char*)data;
+  std::string legacy(text, size);
+
+  size_t bad_pos = 0;
+  ConfigError err = checkMACAddress(text, size, &bad_pos);
+  bool valid = (err == CONFIG_OK);
+  if (valid != legacyValidateMACAddress(legacy)) abort();
+  if (!valid && err != CONFIG_ERR_LENGTH && bad_pos >= size) abort();
+
+  uint8_t parsed[6] = {0xA5, 0xA5, 0xA5, 0xA5, 0xA5, 0xA5};
+  if (parseMACAddress(text, size, parsed) != valid) abort();
+
+  if (valid) {
+    uint8_t expected[6];
+    if (legacyParseMAC(legacy.c_str(), expected) != 6) abort();
+    if (memcmp(parsed, expected, 6) != 0) abort();
+
+    uint8_t base[6];
+    deriveBaseMACForBLE(parsed, base);
+    if (memcmp(base, parsed, 5) != 0) abort();
+    if ((uint8_t)(base[5] + 2) != parsed[5]) abort();
+  } else {
+    for (int i = 0; i < 6; i++) {
+      if (parsed[i] != 0xA5) abort();
+    }
+  }
+
+  return 0;
+}
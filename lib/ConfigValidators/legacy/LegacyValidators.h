@@ -0,0 +1,60 @@
+/**
+ * 固件原有校验/解析实现的主机移植版（String 换成 std::string，去掉串口输出），
+ * 仅供基准测试对比和差分模糊测试作为行为基准，固件不使用。
+ */
+
+#ifndef LEGACY_VALIDATORS_H
+#define LEGACY_VALIDATORS_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+inline bool legacyValidateBafaUID(const std::string& uid) {
+  return !(uid.length() == 0 || uid.length() > 64);
+}
+
+inline bool legacyValidateBafaTopic(const std::string& topic) {
+  return !(topic.length() == 0 || topic.length() > 32);
+}
+
+inline bool legacyValidateMACAddress(const std::string& mac) {
+  if (mac.length() != 17) return false;
+  for (int i = 0; i < 17; i++) {
+    if (i % 3 == 2) {
+      if (mac[i] != ':') return false;
+    } else {
+      if (!isxdigit((unsigned char)mac[i])) return false;
+    }
+  }
+  return true;
+}
+
+inline bool legacyValidateHexData(const std::string& hex) {
+  if (hex.length() == 0) return true;
+  if (hex.length() % 2 != 0) return false;
+  if (hex.length() > 64) return false;
+  for (unsigned int i = 0; i < hex.length(); i++) {
+    if (!isxdigit((unsigned char)hex[i])) return false;
+  }
+  return true;
+}
+
+inline std::string legacyHexToBytes(const std::string& hex) {
+  std::string result;
+  for (unsigned int i = 0; i < hex.length(); i += 2) {
+    std::string byte = hex.substr(i, 2);
+    result.push_back((char) strtol(byte.c_str(), NULL, 16));
+  }
+  return result;
+}
+
+// initBLE() 中的 sscanf 解析，返回成功转换的字段数
+inline int legacyParseMAC(const char* mac, uint8_t out[6]) {
+  return sscanf(mac, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+                &out[0], &out[1], &out[2], &out[3], &out[4], &out[5]);
+}
+
+#endif // LEGACY_VALIDATORS_H
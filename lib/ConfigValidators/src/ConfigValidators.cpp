@@ -0,0 +1,109 @@
+#include "ConfigValidators.h"
+
+#include <string.h>
+
+const int8_t HEX_DIGIT_VALUE[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+ConfigError checkBafaUID(const char* uid, size_t len) {
+  (void)uid;
+  return (len == 0 || len > BAFA_UID_MAX_LEN) ? CONFIG_ERR_LENGTH : CONFIG_OK;
+}
+
+ConfigError checkBafaTopic(const char* topic, size_t len) {
+  (void)topic;
+  return (len == 0 || len > BAFA_TOPIC_MAX_LEN) ? CONFIG_ERR_LENGTH : CONFIG_OK;
+}
+
+ConfigError checkMACAddress(const char* mac, size_t len, size_t* bad_pos) {
+  if (len != MAC_ADDRESS_LEN) {
+    return CONFIG_ERR_LENGTH;
+  }
+
+  for (size_t i = 0; i < MAC_ADDRESS_LEN; i++) {
+    if (i % 3 == 2) {
+      if (mac[i] != ':') {
+        if (bad_pos) *bad_pos = i;
+        return CONFIG_ERR_SEPARATOR;
+      }
+    } else if (HEX_DIGIT_VALUE[(uint8_t)mac[i]] < 0) {
+      if (bad_pos) *bad_pos = i;
+      return CONFIG_ERR_HEX_CHAR;
+    }
+  }
+
+  return CONFIG_OK;
+}
+
+ConfigError checkHexData(const char* hex, size_t len, size_t* bad_pos) {
+  // 允许空数据（使用内置广播数据）
+  if (len == 0) {
+    return CONFIG_OK;
+  }
+
+  if (len % 2 != 0) {
+    return CONFIG_ERR_ODD_LENGTH;
+  }
+
+  if (len > HEX_DATA_MAX_LEN) {
+    return CONFIG_ERR_LENGTH;
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    if (HEX_DIGIT_VALUE[(uint8_t)hex[i]] < 0) {
+      if (bad_pos) *bad_pos = i;
+      return CONFIG_ERR_HEX_CHAR;
+    }
+  }
+
+  return CONFIG_OK;
+}
+
+bool parseMACAddress(const char* mac, size_t len, uint8_t out[6]) {
+  if (checkMACAddress(mac, len, NULL) != CONFIG_OK) {
+    return false;
+  }
+
+  for (size_t i = 0; i < 6; i++) {
+    out[i] = (uint8_t)((HEX_DIGIT_VALUE[(uint8_t)mac[i * 3]] << 4) |
+                       HEX_DIGIT_VALUE[(uint8_t)mac[i * 3 + 1]]);
+  }
+  return true;
+}
+
+int decodeHexData(const char* hex, size_t len, uint8_t* out, size_t out_cap) {
+  if (len % 2 != 0 || len / 2 > out_cap) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < len; i += 2) {
+    int8_t hi = HEX_DIGIT_VALUE[(uint8_t)hex[i]];
+    int8_t lo = HEX_DIGIT_VALUE[(uint8_t)hex[i + 1]];
+    if (hi < 0 || lo < 0) {
+      return -1;
+    }
+    out[i / 2] = (uint8_t)((hi << 4) | lo);
+  }
+  return (int)(len / 2);
+}
+
+void deriveBaseMACForBLE(const uint8_t ble_mac[6], uint8_t base_mac[6]) {
+  memcpy(base_mac, ble_mac, 6);
+  base_mac[5] = (uint8_t)(base_mac[5] - 2);
+}
@@ -0,0 +1,51 @@
+/**
+ * 配置参数校验与解析（不依赖 Arduino，可在主机上编译）
+ * - Bafa UID / Topic 长度校验
+ * - BLE MAC 地址校验与解析
+ * - BLE 广播数据十六进制校验与解码
+ * 所有函数均按 (指针, 长度) 处理输入，不分配内存。
+ */
+
+#ifndef CONFIG_VALIDATORS_H
+#define CONFIG_VALIDATORS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 长度限制（与配置页面及全局缓冲区保持一致）
+#define BAFA_UID_MAX_LEN 64
+#define BAFA_TOPIC_MAX_LEN 32
+#define MAC_ADDRESS_LEN 17
+#define HEX_DATA_MAX_LEN 64
+#define HEX_DATA_MAX_BYTES (HEX_DATA_MAX_LEN / 2)
+
+// 校验结果
+enum ConfigError {
+  CONFIG_OK,
+  CONFIG_ERR_LENGTH,      // 长度不合法（为空、超长或不等于固定长度）
+  CONFIG_ERR_ODD_LENGTH,  // 十六进制数据长度为奇数
+  CONFIG_ERR_SEPARATOR,   // MAC 地址缺少 ':'
+  CONFIG_ERR_HEX_CHAR     // 出现非十六进制字符
+};
+
+// 十六进制字符值查表，非十六进制字符为 -1
+extern const int8_t HEX_DIGIT_VALUE[256];
+
+ConfigError checkBafaUID(const char* uid, size_t len);
+ConfigError checkBafaTopic(const char* topic, size_t len);
+
+// bad_pos 可为 NULL；出错时写入首个非法字符的位置
+ConfigError checkMACAddress(const char* mac, size_t len, size_t* bad_pos);
+ConfigError checkHexData(const char* hex, size_t len, size_t* bad_pos);
+
+// 解析 AA:BB:CC:DD:EE:FF 格式的 MAC 地址，格式不合法时返回 false 且不修改 out
+bool parseMACAddress(const char* mac, size_t len, uint8_t out[6]);
+
+// 解码十六进制字符串，返回字节数；长度为奇数、含非法字符或超出 out_cap 时返回 -1
+int decodeHexData(const char* hex, size_t len, uint8_t* out, size_t out_cap);
+
+// ESP-IDF 的蓝牙 MAC = 基础 MAC 最后一个字节 +2（按 uint8_t 回绕，不向前进位），
+// 这里做逆运算，得到让蓝牙使用 ble_mac 时需要设置的基础 MAC
+void deriveBaseMACForBLE(const uint8_t ble_mac[6], uint8_t base_mac[6]);
+
+#endif // CONFIG_VALIDATORS_H
@@ -17,6 +17,7 @@
 #include <BLEUtils.h>
 #include <BLEAdvertising.h>
 #include <esp_mac.h>
+#include <ConfigValidators.h>
 
 // ********************* 需要修改的配置部分 **********************
 //const char* ssid = "minke";        // 替换为你的Wi-Fi名称
@@ -36,6 +37,24 @@
 #define LONG_PRESS_MS 3000
 #define CONFIG_PORTAL_TIMEOUT 120
 #define BLE_ADVERTISING_DURATION 1000  // BLE广告持续时间1秒
+#define HEARTBEAT_MAX_INTERVAL_MS 50000   // 心跳间隔上限（巴法云要求设备60秒内有发送）
+#define HEARTBEAT_MIN_INTERVAL_MS 15000   // 心跳间隔下限
+#define HEARTBEAT_STEP_MS 5000            // 心跳间隔自适应步长
+#define HEARTBEAT_GROW_AFTER 10           // 连续成功应答多少次后尝试放宽间隔
+#define HEARTBEAT_CEILING_DECAY_MS 1800000  // 连续30分钟无空闲失效后将学到的上限放宽一步
+#define SERVER_ACK_TIMEOUT_MS 10000       // 等待服务器应答的期限
+#define SERVER_RECONNECT_MIN_BACKOFF_MS 2000   // 巴法云重连退避初始值
+#define SERVER_RECONNECT_MAX_BACKOFF_MS 60000  // 巴法云重连退避上限
+#define WIFI_STORE_MAX_APS 4                 // 最多保存的WiFi网络数量
+#define WIFI_RECONNECT_MIN_BACKOFF_MS 1000   // WiFi重连退避初始值
+#define WIFI_RECONNECT_MAX_BACKOFF_MS 30000  // WiFi重连退避上限
+#define WIFI_CONNECT_TIMEOUT_MS 8000         // 单次WiFi连接尝试超时
+#define WIFI_CONNECT_GRACE_MS 500            // 发起连接后忽略上一次尝试遗留的失败状态
+#define WIFI_SCAN_MS_PER_CHANNEL 120         // 定向扫描每个信道的驻留时间
+#define LATENCY_PROBE_INTERVAL_MS 15000  // 云端延迟探测间隔15秒
+#define LATENCY_STATS_INTERVAL_MS 50000  // 延迟统计输出间隔（与默认心跳间隔一致）
+#define LATENCY_PROBE_TOPIC_SUFFIX "lp"  // 探测主题 = 主题名 + 后缀（需在巴法云控制台创建）
+#define LATENCY_HIST_BUCKETS 24          // 延迟直方图对数分桶数量
 
 // 定义设备名称
 #define DEVICE_NAME "ESP32C3_BLE_Beacon"
@@ -60,6 +79,28 @@ bool bleInitialized = false;
 bool ledState = false;
 unsigned long bleAdvertisingStart = 0;
 
+// 延迟直方图（对数分桶：桶 0 只记录 0，桶 i 覆盖 [2^(i-1), 2^i - 1]，最后一个桶收纳溢出值）
+struct LatencyHistogram {
+  const char* name;
+  const char* unit;
+  uint32_t buckets[LATENCY_HIST_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+};
+
+LatencyHistogram cloud_rtt_hist = {"Cloud RTT", "ms", {0}, 0, 0};   // 探测消息经巴法云往返耗时
+LatencyHistogram dispatch_hist = {"Dispatch", "us", {0}, 0, 0};     // 收到指令到完成LED/BLE动作耗时
+LatencyHistogram rx_wait_hist = {"Rx wait", "ms", {0}, 0, 0};       // 指令在套接字中等待被读取的时长上界（前一次轮询至今）
+LatencyHistogram loop_gap_hist = {"Loop gap", "ms", {0}, 0, 0};     // 相邻两次轮询套接字的间隔（含 delay 和各类阻塞）
+unsigned long last_rx_poll = 0;
+LatencyHistogram reconnect_hist = {"WiFi reconnect", "ms", {0}, 0, 0};  // WiFi断开到重新连上耗时
+
+// 延迟探测相关变量
+bool latency_probe_enabled = false;
+uint32_t latency_probe_seq = 0;
+unsigned long last_latency_probe = 0;
+unsigned long last_latency_stats = 0;
+
 // 自定义MAC地址 (最后三个字节可以更改)
 uint8_t newMAC[6] = {0x78, 0x81, 0x8c, 0x06, 0x9a, 0xc4};
 
@@ -87,10 +128,48 @@ enum SystemStatus {
 };
 
 SystemStatus current_status = STATUS_BOOT;
-bool wm_nonblocking = false;
+bool config_portal_active = false;  // 按键触发的非阻塞配置门户是否正在运行
 unsigned long last_led_toggle = 0;
 bool led_state = false;
 
+// 已知WiFi网络（按最近使用排序，持久化在 "wifi_aps" 命名空间）
+struct KnownAP {
+  char ssid[33];
+  char pass[65];
+  uint8_t channel;  // 上次连接时的信道，0 表示未知
+};
+
+KnownAP known_aps[WIFI_STORE_MAX_APS];
+uint8_t known_ap_count = 0;
+
+// WiFi主动重连状态机
+enum WiFiReconnectState {
+  WIFI_RC_IDLE,        // 已连接或未开始
+  WIFI_RC_WAIT,        // 等待退避结束
+  WIFI_RC_SCANNING,    // 扫描中（先逐个扫描已知信道，再全信道扫描）
+  WIFI_RC_CONNECTING   // 正在连接选中的AP
+};
+
+WiFiReconnectState wifi_rc_state = WIFI_RC_IDLE;
+bool wifi_was_connected = false;
+bool wifi_outage_active = false;
+unsigned long wifi_outage_start = 0;
+unsigned long wifi_rc_next_attempt = 0;
+unsigned long wifi_rc_backoff = WIFI_RECONNECT_MIN_BACKOFF_MS;
+unsigned long wifi_rc_connect_start = 0;
+uint8_t wifi_scan_channels[WIFI_STORE_MAX_APS];
+uint8_t wifi_scan_channel_count = 0;
+uint8_t wifi_scan_channel_idx = 0;  // 等于 wifi_scan_channel_count 时表示正在全信道扫描
+int8_t wifi_best_ap = -1;
+int32_t wifi_best_rssi = 0;
+uint8_t wifi_best_channel = 0;
+uint8_t wifi_direct_idx = 0;  // 扫描不到时轮流直连的已知网络序号（隐藏SSID不出现在扫描结果中）
+
+// 配置热更新标志（保存回调置位，主循环中执行）
+bool pending_resubscribe = false;   // UID/主题变更，需重新订阅
+bool pending_ble_reinit = false;    // MAC变更，需重新初始化BLE
+bool pending_ble_rearm = false;     // 广播数据变更，需重新装载广播
+
 // 对象实例
 WiFiManager wm;
 Preferences prefs;
@@ -105,11 +184,38 @@ WiFiManagerParameter param_ble_data;
 const char* host = "bemfa.com";
 const int port = 8344;
 
+// 心跳调度与服务器应答跟踪
+unsigned long last_server_tx = 0;          // 最近一次发送时间
+unsigned long last_server_rx = 0;          // 最近一次收到数据时间
+unsigned long ack_sent_at = 0;             // 待应答请求的发送时间
+unsigned long ack_idle_before = 0;         // 待应答请求发送前链路已空闲的时长
+bool awaiting_ack = false;                 // 是否有请求在等待服务器应答
+unsigned long heartbeat_interval = HEARTBEAT_MAX_INTERVAL_MS;
+uint8_t heartbeat_ok_streak = 0;
+unsigned long heartbeat_ceiling = HEARTBEAT_MAX_INTERVAL_MS;  // 学到的间隔上限（最近一次空闲失效时长的3/4）
+unsigned long heartbeat_ceiling_since = 0;                    // 上限最近一次调整的时间
+unsigned long last_server_reconnect = 0;  // 最近一次连接尝试结束的时间
+unsigned long server_reconnect_backoff = SERVER_RECONNECT_MIN_BACKOFF_MS;
+bool server_was_connected = false;
+bool server_reconnect_now = false;         // 下次有WiFi时立即重连，不等待退避
+
 // 函数声明
 void saveParamCallback();
 String getParam(String name);
 void loadSavedParams();
 void checkButton();
+void handleConfigPortal();
+void applyPendingConfig();
+void loadKnownAPs();
+void saveKnownAPs();
+void rememberAP(const String& ssid, const String& pass, uint8_t channel);
+void rememberCurrentAP();
+void printKnownAPs();
+void handleWiFiReconnect();
+void onWiFiConnected();
+void startWiFiScan();
+void handleWiFiScanResults(int16_t n);
+void scheduleWiFiRetry();
 void updateStatusLED();
 void safeRestart(const char* reason);
 bool validateBafaUID(const String& uid);
@@ -121,11 +227,26 @@ bool initializePreferences();
 void setup_wifi();
 void connect_server();
 void send_heartbeat();
+void sendToServer(const String& cmd);
+void noteServerRx(const String& message);
+void handleKeepalive();
+void noteLinkFailure(unsigned long idle);
+void requestServerReconnect();
 void initBLE();
 void startBLEAdvertising();
 void stopBLEAdvertising();
 void handleBLEAdvertising();
-std::string hexToBytes(const String& hex);
+String getProbeTopic();
+void sendLatencyProbe();
+bool handleLatencyProbeEcho(const String& message);
+void publishLatencyStats();
+void reportLatencyStats();
+void handleSerialCommand();
+void histogramRecord(LatencyHistogram& h, uint32_t value);
+uint32_t histogramPercentile(const LatencyHistogram& h, uint8_t pct);
+void histogramReset(LatencyHistogram& h);
+void printHistogram(const LatencyHistogram& h);
+void printHistogramSummary(const LatencyHistogram& h);
 
 // 创建WiFi客户端对象
 WiFiClient client;
@@ -164,11 +285,7 @@ void setup() {
   
   // 从 Preferences 加载已保存的参数
   loadSavedParams();
-  
-  // WiFiManager 配置
-  if (wm_nonblocking) {
-    wm.setConfigPortalBlocking(false);
-  }
+  loadKnownAPs();
   
   // 创建参数对象（使用已加载的 buffer 作为默认值）
   new (&param_bafa_uid) WiFiManagerParameter("bafa_uid", "Bafa User ID (64 chars max)", bafa_uid_buf, 64);
@@ -190,6 +307,7 @@ void setup() {
   wm.setMenu(menu);
   wm.setClass("invert"); // 暗色主题
   wm.setConfigPortalTimeout(30); // 初始连接30秒超时
+  wm.setWiFiAutoReconnect(false); // 断线重连由主循环中的重连管理器负责
   
   // 设置自定义信息
   wm.setCustomHeadElement("<style>html{background:#1e1e1e;}</style>");
@@ -205,6 +323,8 @@ void setup() {
     current_status = STATUS_ERROR;
   } else {
     Serial.println("✅ WiFi Connected!");
+    // 断线后由主循环中的重连管理器接管，避免与系统自动重连冲突
+    WiFi.setAutoReconnect(false);
     Serial.print("📶 IP Address: ");
     Serial.println(WiFi.localIP());
     Serial.print("📡 RSSI: ");
@@ -222,34 +342,46 @@ void loop() {
   // 喂看门狗
   esp_task_wdt_reset();
   
-  // WiFiManager 处理（非阻塞模式）
-  if (wm_nonblocking) {
-    wm.process();
+  // WiFiManager 处理（按键触发的非阻塞配置门户）
+  if (config_portal_active) {
+    handleConfigPortal();
   }
   
+  // 应用门户中保存的配置变更
+  applyPendingConfig();
+  
   // 按键检测
   checkButton();
   
+  // 串口命令
+  handleSerialCommand();
+  
   // LED状态指示
   updateStatusLED();
   
-  // 连接状态监控
-  if (current_status == STATUS_CONNECTED && WiFi.status() != WL_CONNECTED) {
-    Serial.println("⚠️  WiFi connection lost, attempting reconnection...");
-    current_status = STATUS_CONNECTING;
-  } else if (current_status == STATUS_CONNECTING && WiFi.status() == WL_CONNECTED) {
-    current_status = STATUS_CONNECTED;
-    Serial.println("✅ WiFi reconnected");
+  // 连接状态监控与主动重连
+  handleWiFiReconnect();
+  
+  // 记录两次轮询之间的间隔：消息到达后最多要等这么久才会被读取
+  unsigned long poll_now = millis();
+  unsigned long poll_gap = poll_now - last_rx_poll;
+  if (last_rx_poll != 0) {
+    histogramRecord(loop_gap_hist, poll_gap);
   }
+  last_rx_poll = poll_now;
   
   // 处理从服务器收到的消息
   if (client.available()) {
+    unsigned long rx_start = micros();
     String message = client.readStringUntil('\n');
     Serial.print("Received: ");
     Serial.println(message);
+    noteServerRx(message);
 
-    // 解析消息：判断是否包含 "on" 或 "off"
-    if (message.indexOf("on") != -1) {
+    // 延迟探测回显必须先于开关指令解析，避免误触发
+    if (handleLatencyProbeEcho(message)) {
+      // 探测消息已处理
+    } else if (message.indexOf("on") != -1) {
       digitalWrite(BAFA_LED_PIN, HIGH); // 开灯
       ledState = true;
       Serial.println("LED turned ON");
@@ -259,6 +391,8 @@ void loop() {
         initBLE();
       }
       startBLEAdvertising();
+      histogramRecord(dispatch_hist, micros() - rx_start);
+      histogramRecord(rx_wait_hist, poll_gap);
     } else if (message.indexOf("off") != -1) {
       digitalWrite(BAFA_LED_PIN, LOW); // 关灯
       ledState = false;
@@ -266,18 +400,28 @@ void loop() {
       
       // 停止BLE广播
       stopBLEAdvertising();
+      histogramRecord(dispatch_hist, micros() - rx_start);
+      histogramRecord(rx_wait_hist, poll_gap);
     }
   }
 
   // 处理BLE广告持续时间
   handleBLEAdvertising();
 
-  // 每50秒发送一次心跳包（巴法云要求60秒内有通信）
-  static unsigned long lastHeartbeat = 0;
-  if (millis() - lastHeartbeat > 50000) {
-    send_heartbeat();
-    lastHeartbeat = millis();
+  // 周期性发送延迟探测消息
+  if (latency_probe_enabled && millis() - last_latency_probe > LATENCY_PROBE_INTERVAL_MS) {
+    sendLatencyProbe();
+    last_latency_probe = millis();
+  }
+
+  // 周期性输出延迟统计（独立计时，心跳会因探测等流量被推迟）
+  if (millis() - last_latency_stats > LATENCY_STATS_INTERVAL_MS) {
+    reportLatencyStats();
+    last_latency_stats = millis();
   }
+
+  // 心跳调度、应答超时检测与断线重连
+  handleKeepalive();
   
   delay(100);
 }
@@ -323,9 +467,9 @@ bool initializePreferences() {
   return true;
 }
 
-// 参数验证函数
+// 参数验证函数（校验逻辑见 lib/ConfigValidators，这里只负责输出错误原因）
 bool validateBafaUID(const String& uid) {
-  if (uid.length() == 0 || uid.length() > 64) {
+  if (checkBafaUID(uid.c_str(), uid.length()) != CONFIG_OK) {
     Serial.println("❌ Bafa UID validation failed: invalid length");
     return false;
   }
@@ -334,7 +478,7 @@ bool validateBafaUID(const String& uid) {
 }
 
 bool validateBafaTopic(const String& topic) {
-  if (topic.length() == 0 || topic.length() > 32) {
+  if (checkBafaTopic(topic.c_str(), topic.length()) != CONFIG_OK) {
     Serial.println("❌ Bafa topic validation failed: invalid length");
     return false;
   }
@@ -343,52 +487,40 @@ bool validateBafaTopic(const String& topic) {
 }
 
 bool validateMACAddress(const String& mac) {
-  if (mac.length() != 17) {
-    Serial.println("❌ MAC address validation failed: incorrect length");
-    return false;
-  }
-  
-  for (int i = 0; i < 17; i++) {
-    if (i % 3 == 2) {
-      if (mac[i] != ':') {
-        Serial.println("❌ MAC address validation failed: missing ':' at position " + String(i));
-        return false;
-      }
-    } else {
-      if (!isxdigit(mac[i])) {
-        Serial.println("❌ MAC address validation failed: invalid hex character at position " + String(i));
-        return false;
-      }
-    }
+  size_t pos = 0;
+  switch (checkMACAddress(mac.c_str(), mac.length(), &pos)) {
+    case CONFIG_OK:
+      return true;
+    case CONFIG_ERR_SEPARATOR:
+      Serial.println("❌ MAC address validation failed: missing ':' at position " + String(pos));
+      return false;
+    case CONFIG_ERR_HEX_CHAR:
+      Serial.println("❌ MAC address validation failed: invalid hex character at position " + String(pos));
+      return false;
+    default:
+      Serial.println("❌ MAC address validation failed: incorrect length");
+      return false;
   }
-  
-  return true;
 }
 
 bool validateHexData(const String& hex) {
-  if (hex.length() == 0) {
-    Serial.println("⚠️  Hex data is empty");
-    return true; // 允许空数据
-  }
-  
-  if (hex.length() % 2 != 0) {
-    Serial.println("❌ Hex data validation failed: odd length");
-    return false;
-  }
-  
-  if (hex.length() > 64) {
-    Serial.println("❌ Hex data validation failed: too long");
-    return false;
-  }
-  
-  for (unsigned int i = 0; i < hex.length(); i++) {
-    if (!isxdigit(hex[i])) {
-      Serial.println("❌ Hex data validation failed: invalid character at position " + String(i));
+  size_t pos = 0;
+  switch (checkHexData(hex.c_str(), hex.length(), &pos)) {
+    case CONFIG_OK:
+      if (hex.length() == 0) {
+        Serial.println("⚠️  Hex data is empty");
+      }
+      return true; // 允许空数据
+    case CONFIG_ERR_ODD_LENGTH:
+      Serial.println("❌ Hex data validation failed: odd length");
+      return false;
+    case CONFIG_ERR_HEX_CHAR:
+      Serial.println("❌ Hex data validation failed: invalid character at position " + String(pos));
+      return false;
+    default:
+      Serial.println("❌ Hex data validation failed: too long");
       return false;
-    }
   }
-  
-  return true;
 }
 
 // 从 Web 服务器获取参数值
@@ -437,6 +569,11 @@ void saveParamCallback() {
   Serial.println("   BLE MAC: " + mac);
   Serial.println("   BLE Data: " + data);
   
+  // 记录哪些参数发生变化，用于保存后热应用
+  bool bafa_changed = (uid != bafa_uid_buf) || (topic != bafa_topic_buf);
+  bool mac_changed = (mac != ble_mac_buf);
+  bool data_changed = (data != ble_data_buf);
+  
   // 保存到 NVS
   if (!prefs.begin("config", false)) {
     Serial.println("❌ Failed to open preferences for writing");
@@ -466,6 +603,10 @@ void saveParamCallback() {
     ble_data_buf[sizeof(ble_data_buf) - 1] = '\0';
     
     Serial.println("✅ Parameters saved successfully to flash memory");
+    
+    pending_resubscribe |= bafa_changed;
+    pending_ble_reinit |= mac_changed;
+    pending_ble_rearm |= data_changed;
   } else {
     Serial.println("❌ Failed to save parameters to flash memory");
   }
@@ -576,6 +717,10 @@ void checkButton() {
       }
       
       // 清除 WiFi 配置
+      if (prefs.begin("wifi_aps", false)) {
+        prefs.clear();
+        prefs.end();
+      }
       wm.resetSettings();
       Serial.println("   ✅ WiFi settings cleared");
       
@@ -587,56 +732,648 @@ void checkButton() {
       
       safeRestart("Factory reset completed");
       
+    } else if (config_portal_active) {
+      // 门户运行中再次短按：关闭配置门户
+      Serial.println("⚙️  Short press detected: Closing config portal");
+      wm.stopConfigPortal();
     } else {
-      // 短按：启动配置门户
+      // 短按：以非阻塞方式启动配置门户，主循环继续处理云端指令和心跳
       Serial.println("⚙️  Short press detected: Starting config portal");
       current_status = STATUS_CONFIG_MODE;
       
+      wm.setConfigPortalBlocking(false);
       wm.setConfigPortalTimeout(CONFIG_PORTAL_TIMEOUT);
+      wm.startConfigPortal("ESP32-OnDemand", "12345678");
       
-      if (!wm.startConfigPortal("ESP32-OnDemand", "12345678")) {
-        Serial.println("❌ Config portal failed or timed out");
-        current_status = (WiFi.status() == WL_CONNECTED) ? STATUS_CONNECTED : STATUS_ERROR;
+      if (wm.getConfigPortalActive()) {
+        config_portal_active = true;
+        Serial.println("✅ Config portal running (non-blocking)");
       } else {
-        Serial.println("✅ Config portal completed successfully");
-        current_status = STATUS_CONNECTED;
-        
-        Serial.println("📶 Updated connection info:");
-        Serial.println("   SSID: " + WiFi.SSID());
-        Serial.println("   IP: " + WiFi.localIP().toString());
-        Serial.println("   RSSI: " + String(WiFi.RSSI()) + " dBm");
-        
-        // 连接巴法云服务器
-        connect_server();
+        Serial.println("❌ Config portal failed to start");
+        current_status = (WiFi.status() == WL_CONNECTED) ? STATUS_CONNECTED : STATUS_ERROR;
       }
     }
   }
 }
 
+// 非阻塞配置门户处理
+void handleConfigPortal() {
+  if (wm.process()) {
+    // 门户中保存了新的WiFi并连接成功，原TCP连接已失效
+    Serial.println("✅ Config portal completed successfully");
+    Serial.println("📶 Updated connection info:");
+    Serial.println("   SSID: " + WiFi.SSID());
+    Serial.println("   IP: " + WiFi.localIP().toString());
+    Serial.println("   RSSI: " + String(WiFi.RSSI()) + " dBm");
+    rememberCurrentAP();
+    requestServerReconnect();
+  }
+  
+  // 门户已关闭（保存完成、超时或用户退出）
+  if (!wm.getConfigPortalActive()) {
+    config_portal_active = false;
+    if (WiFi.status() == WL_CONNECTED) {
+      Serial.println("✅ Config portal closed");
+      current_status = STATUS_CONNECTED;
+    } else {
+      Serial.println("❌ Config portal closed without WiFi connection");
+      current_status = STATUS_ERROR;
+    }
+  }
+}
+
+// 热应用配置变更，无需重启
+void applyPendingConfig() {
+  if (pending_resubscribe) {
+    pending_resubscribe = false;
+    Serial.println("🔁 Bafa config changed, reconnecting to Bemfa Cloud...");
+    requestServerReconnect();
+  }
+  
+  if (pending_ble_reinit) {
+    pending_ble_reinit = false;
+    if (bleInitialized) {
+      // 基础MAC只在BLE初始化时生效，需释放后重新初始化
+      stopBLEAdvertising();
+      BLEDevice::deinit(false);
+      bleInitialized = false;
+      Serial.println("🔁 BLE MAC changed, BLE will re-initialize on next wake");
+    }
+  }
+  
+  if (pending_ble_rearm) {
+    pending_ble_rearm = false;
+    // 正在广播时立即换用新数据，否则下次唤醒自动使用
+    if (bleAdvertisingStart > 0) {
+      Serial.println("🔁 BLE data changed, restarting advertising");
+      startBLEAdvertising();
+    }
+  }
+}
+
+// 从 Preferences 加载已知WiFi网络
+void loadKnownAPs() {
+  known_ap_count = 0;
+  
+  if (!prefs.begin("wifi_aps", true)) {
+    return;  // 尚未保存过
+  }
+  
+  uint8_t count = prefs.getUChar("count", 0);
+  for (uint8_t i = 0; i < count && i < WIFI_STORE_MAX_APS; i++) {
+    String ssid = prefs.getString(("ssid" + String(i)).c_str(), "");
+    String pass = prefs.getString(("pass" + String(i)).c_str(), "");
+    if (ssid.length() == 0) continue;
+    
+    KnownAP& ap = known_aps[known_ap_count++];
+    strncpy(ap.ssid, ssid.c_str(), sizeof(ap.ssid) - 1);
+    ap.ssid[sizeof(ap.ssid) - 1] = '\0';
+    strncpy(ap.pass, pass.c_str(), sizeof(ap.pass) - 1);
+    ap.pass[sizeof(ap.pass) - 1] = '\0';
+    ap.channel = prefs.getUChar(("ch" + String(i)).c_str(), 0);
+  }
+  
+  prefs.end();
+  Serial.println("✅ Loaded " + String(known_ap_count) + " known WiFi network(s)");
+}
+
+// 保存已知WiFi网络
+void saveKnownAPs() {
+  if (!prefs.begin("wifi_aps", false)) {
+    Serial.println("❌ Failed to open WiFi store for writing");
+    return;
+  }
+  
+  prefs.clear();
+  prefs.putUChar("count", known_ap_count);
+  for (uint8_t i = 0; i < known_ap_count; i++) {
+    prefs.putString(("ssid" + String(i)).c_str(), known_aps[i].ssid);
+    prefs.putString(("pass" + String(i)).c_str(), known_aps[i].pass);
+    prefs.putUChar(("ch" + String(i)).c_str(), known_aps[i].channel);
+  }
+  
+  prefs.end();
+}
+
+// 记录一个WiFi网络并移到列表最前（已满时淘汰最久未用的）
+void rememberAP(const String& ssid, const String& pass, uint8_t channel) {
+  if (ssid.length() == 0 || ssid.length() >= sizeof(known_aps[0].ssid) ||
+      pass.length() >= sizeof(known_aps[0].pass)) {
+    return;
+  }
+  
+  int found = -1;
+  for (uint8_t i = 0; i < known_ap_count; i++) {
+    if (ssid == known_aps[i].ssid) {
+      found = i;
+      break;
+    }
+  }
+  
+  // 已是最近使用且内容未变，不写 flash
+  if (found == 0 && pass == known_aps[0].pass && channel == known_aps[0].channel) {
+    return;
+  }
+  
+  uint8_t last = (found >= 0) ? found : (known_ap_count < WIFI_STORE_MAX_APS ? known_ap_count++ : known_ap_count - 1);
+  for (uint8_t i = last; i > 0; i--) {
+    known_aps[i] = known_aps[i - 1];
+  }
+  
+  strcpy(known_aps[0].ssid, ssid.c_str());
+  strcpy(known_aps[0].pass, pass.c_str());
+  known_aps[0].channel = channel;
+  
+  saveKnownAPs();
+  Serial.println("💾 WiFi network remembered: " + ssid + " (ch " + String(channel) + ")");
+}
+
+// 记录当前连接的WiFi网络
+void rememberCurrentAP() {
+  if (WiFi.status() != WL_CONNECTED) return;
+  rememberAP(WiFi.SSID(), WiFi.psk(), WiFi.channel());
+}
+
+// 打印已知WiFi网络
+void printKnownAPs() {
+  Serial.println("📶 Known WiFi networks (" + String(known_ap_count) + "/" + String(WIFI_STORE_MAX_APS) + "):");
+  for (uint8_t i = 0; i < known_ap_count; i++) {
+    Serial.println("   [" + String(i) + "] " + String(known_aps[i].ssid) + " (ch " + String(known_aps[i].channel) + ")");
+  }
+}
+
+// WiFi连接监控：断线后按信号强度在已知网络中挑选AP，带退避在后台重连
+void handleWiFiReconnect() {
+  unsigned long now = millis();
+  
+  if (WiFi.status() == WL_CONNECTED) {
+    if (!wifi_was_connected) {
+      wifi_was_connected = true;
+      onWiFiConnected();
+    }
+    return;
+  }
+  
+  if (wifi_was_connected) {
+    wifi_was_connected = false;
+    Serial.println("⚠️  WiFi connection lost, attempting reconnection...");
+    
+    // WiFi断开导致的TCP失效不是服务器/NAT空闲超时，WiFi恢复后由心跳调度重连
+    requestServerReconnect();
+  }
+  
+  // 门户运行期间由 WiFiManager 管理连接
+  if (config_portal_active) return;
+  
+  if (!wifi_outage_active) {
+    wifi_outage_active = true;
+    wifi_outage_start = now;
+    current_status = STATUS_CONNECTING;
+  }
+  
+  switch (wifi_rc_state) {
+    case WIFI_RC_IDLE:
+      // 停止系统的重连尝试，由重连管理器接管
+      WiFi.mode(WIFI_STA);
+      WiFi.disconnect();
+      wifi_rc_backoff = WIFI_RECONNECT_MIN_BACKOFF_MS;
+      wifi_rc_next_attempt = now;
+      wifi_rc_state = WIFI_RC_WAIT;
+      break;
+      
+    case WIFI_RC_WAIT:
+      if ((long)(now - wifi_rc_next_attempt) >= 0) {
+        // 收集已知信道，先做定向扫描
+        wifi_scan_channel_count = 0;
+        for (uint8_t i = 0; i < known_ap_count; i++) {
+          uint8_t ch = known_aps[i].channel;
+          bool dup = (ch == 0);
+          for (uint8_t j = 0; j < wifi_scan_channel_count && !dup; j++) {
+            dup = (wifi_scan_channels[j] == ch);
+          }
+          if (!dup) {
+            wifi_scan_channels[wifi_scan_channel_count++] = ch;
+          }
+        }
+        wifi_scan_channel_idx = 0;
+        wifi_best_ap = -1;
+        startWiFiScan();
+      }
+      break;
+      
+    case WIFI_RC_SCANNING: {
+      int16_t n = WiFi.scanComplete();
+      if (n == WIFI_SCAN_RUNNING) break;
+      handleWiFiScanResults(n);
+      break;
+    }
+      
+    case WIFI_RC_CONNECTING: {
+      // 密码错误或AP消失时立即重试，不必等满超时
+      wl_status_t status = WiFi.status();
+      if (now - wifi_rc_connect_start > WIFI_CONNECT_GRACE_MS &&
+          (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL)) {
+        Serial.println("❌ WiFi connect attempt failed (status " + String((int)status) + ")");
+        WiFi.disconnect();
+        scheduleWiFiRetry();
+      } else if (now - wifi_rc_connect_start > WIFI_CONNECT_TIMEOUT_MS) {
+        Serial.println("❌ WiFi connect attempt timed out");
+        WiFi.disconnect();
+        scheduleWiFiRetry();
+      }
+      break;
+    }
+  }
+}
+
+// WiFi连上：记录重连耗时和当前网络，并重新订阅巴法云
+void onWiFiConnected() {
+  if (wifi_outage_active) {
+    unsigned long duration = millis() - wifi_outage_start;
+    histogramRecord(reconnect_hist, duration);
+    Serial.println("✅ WiFi reconnected to " + WiFi.SSID() + " in " + String(duration) + " ms");
+  }
+  
+  wifi_outage_active = false;
+  wifi_rc_state = WIFI_RC_IDLE;
+  if (current_status != STATUS_CONFIG_MODE) {
+    current_status = STATUS_CONNECTED;
+  }
+  
+  rememberCurrentAP();
+}
+
+// 启动异步扫描：依次扫描已知信道，最后做一次全信道扫描
+void startWiFiScan() {
+  uint8_t channel = 0;
+  if (wifi_scan_channel_idx < wifi_scan_channel_count) {
+    channel = wifi_scan_channels[wifi_scan_channel_idx];
+  }
+  
+  if (WiFi.scanNetworks(true, false, false, WIFI_SCAN_MS_PER_CHANNEL, channel) == WIFI_SCAN_FAILED) {
+    Serial.println("❌ WiFi scan failed to start");
+    scheduleWiFiRetry();
+    return;
+  }
+  wifi_rc_state = WIFI_RC_SCANNING;
+}
+
+// 处理扫描结果，在已知网络中挑选信号最强的AP
+void handleWiFiScanResults(int16_t n) {
+  for (int16_t i = 0; i < n; i++) {
+    String ssid = WiFi.SSID(i);
+    int32_t rssi = WiFi.RSSI(i);
+    for (uint8_t k = 0; k < known_ap_count; k++) {
+      if (ssid == known_aps[k].ssid && (wifi_best_ap < 0 || rssi > wifi_best_rssi)) {
+        wifi_best_ap = k;
+        wifi_best_rssi = rssi;
+        wifi_best_channel = WiFi.channel(i);
+      }
+    }
+  }
+  WiFi.scanDelete();
+  
+  // 定向扫描未完成则继续下一个信道；定向扫描都没找到再全信道扫描
+  bool full_scan_done = (wifi_scan_channel_idx >= wifi_scan_channel_count);
+  if (n >= 0 && !full_scan_done && (wifi_scan_channel_idx + 1 < wifi_scan_channel_count || wifi_best_ap < 0)) {
+    wifi_scan_channel_idx++;
+    startWiFiScan();
+    return;
+  }
+  
+  if (wifi_best_ap >= 0) {
+    KnownAP& ap = known_aps[wifi_best_ap];
+    Serial.println("📶 Connecting to " + String(ap.ssid) + " (ch " + String(wifi_best_channel) +
+                   ", " + String(wifi_best_rssi) + " dBm)");
+    // 不传 BSSID：WiFi 配置默认写入 flash，锁定 BSSID 会让下次开机的 autoConnect 只连这一台AP；
+    // 只给出最强AP所在信道，驱动会从该信道开始扫描
+    WiFi.begin(ap.ssid, ap.pass, wifi_best_channel);
+  } else if (known_ap_count == 0) {
+    // 尚无已知网络（例如旧版本升级上来），使用系统保存的凭据
+    Serial.println("📶 No known networks stored, retrying saved credentials");
+    WiFi.begin();
+  } else {
+    // 隐藏SSID扫描不到，轮流对已知网络直接发起连接
+    KnownAP& ap = known_aps[wifi_direct_idx % known_ap_count];
+    wifi_direct_idx = (wifi_direct_idx + 1) % known_ap_count;
+    Serial.println("⚠️  No known WiFi network in range, trying " + String(ap.ssid) + " directly (may be hidden)");
+    WiFi.begin(ap.ssid, ap.pass, ap.channel);
+  }
+  
+  wifi_rc_connect_start = millis();
+  wifi_rc_state = WIFI_RC_CONNECTING;
+}
+
+// 指数退避后重试
+void scheduleWiFiRetry() {
+  wifi_rc_next_attempt = millis() + wifi_rc_backoff;
+  Serial.println("   Retrying WiFi in " + String(wifi_rc_backoff / 1000.0, 1) + " s");
+  wifi_rc_backoff *= 2;
+  if (wifi_rc_backoff > WIFI_RECONNECT_MAX_BACKOFF_MS) {
+    wifi_rc_backoff = WIFI_RECONNECT_MAX_BACKOFF_MS;
+  }
+  wifi_rc_state = WIFI_RC_WAIT;
+}
+
 // 连接巴法云服务器并订阅主题
 void connect_server() {
   Serial.print("Connecting to Bemfa Cloud...");
   
-  if (!client.connect(host, port)) {
-    Serial.println(" connection failed!");
-    delay(2000);
+  bool ok = client.connect(host, port);
+  // 连接可能阻塞数秒（DNS + 连接超时），以尝试结束时刻作为退避起点
+  last_server_reconnect = millis();
+  
+  if (!ok) {
+    Serial.println(" connection failed! Retrying in " + String(server_reconnect_backoff / 1000) + " s");
     return;
   }
 
   Serial.println(" connected!");
+  server_reconnect_backoff = SERVER_RECONNECT_MIN_BACKOFF_MS;
 
-  // 发送订阅指令：cmd=1&uid=xxx&topic=xxx
-  String subscribeCmd = "cmd=1&uid=" + String(bafa_uid_buf) + "&topic=" + String(bafa_topic_buf) + "\r\n";
-  client.print(subscribeCmd);
+  // 发送订阅指令：cmd=1&uid=xxx&topic=xxx（启用延迟探测时同时订阅探测主题）
+  String topics = String(bafa_topic_buf);
+  if (latency_probe_enabled) {
+    topics += "," + getProbeTopic();
+  }
+  String subscribeCmd = "cmd=1&uid=" + String(bafa_uid_buf) + "&topic=" + topics + "\r\n";
+  sendToServer(subscribeCmd);
+  server_was_connected = true;
 
-  Serial.println("Subscribed to topic: " + String(bafa_topic_buf));
+  Serial.println("Subscribed to topic: " + topics);
 }
 
 // 发送心跳包
 void send_heartbeat() {
   String heartbeat = "cmd=0&msg=ping\r\n";
-  client.print(heartbeat);
-  Serial.println("Heartbeat sent.");
+  sendToServer(heartbeat);
+  Serial.println("Heartbeat sent (interval " + String(heartbeat_interval / 1000) + " s).");
+}
+
+// 向服务器发送指令，巴法云对每条指令都会应答，借此跟踪链路是否存活
+void sendToServer(const String& cmd) {
+  unsigned long now = millis();
+  
+  if (!awaiting_ack) {
+    unsigned long since_tx = now - last_server_tx;
+    unsigned long since_rx = now - last_server_rx;
+    ack_idle_before = (since_tx < since_rx) ? since_tx : since_rx;
+    ack_sent_at = now;
+    awaiting_ack = true;
+  }
+  
+  client.print(cmd);
+  last_server_tx = now;
+}
+
+// 收到服务器数据：清除待应答状态，心跳应答成功时尝试放宽间隔
+void noteServerRx(const String& message) {
+  last_server_rx = millis();
+  awaiting_ack = false;
+  
+  if (message.startsWith("cmd=0")) {
+    // 长时间没有空闲失效：缓慢放宽学到的上限，偶尔试探更长的间隔
+    if (heartbeat_ceiling < HEARTBEAT_MAX_INTERVAL_MS && last_server_rx - heartbeat_ceiling_since >= HEARTBEAT_CEILING_DECAY_MS) {
+      heartbeat_ceiling += HEARTBEAT_STEP_MS;
+      if (heartbeat_ceiling > HEARTBEAT_MAX_INTERVAL_MS) {
+        heartbeat_ceiling = HEARTBEAT_MAX_INTERVAL_MS;
+      }
+      heartbeat_ceiling_since = last_server_rx;
+      Serial.println("💓 Heartbeat ceiling raised to " + String(heartbeat_ceiling / 1000) + " s");
+    }
+    
+    // 放宽间隔不超过学到的上限，避免反复越过NAT超时
+    heartbeat_ok_streak++;
+    if (heartbeat_ok_streak >= HEARTBEAT_GROW_AFTER && heartbeat_interval < heartbeat_ceiling) {
+      heartbeat_interval += HEARTBEAT_STEP_MS;
+      if (heartbeat_interval > heartbeat_ceiling) {
+        heartbeat_interval = heartbeat_ceiling;
+      }
+      heartbeat_ok_streak = 0;
+      Serial.println("💓 Heartbeat interval relaxed to " + String(heartbeat_interval / 1000) + " s");
+    }
+  }
+}
+
+// 链路在空闲 idle 毫秒后失效，说明服务器或NAT容忍不了这么久，缩短心跳间隔
+void noteLinkFailure(unsigned long idle) {
+  heartbeat_ok_streak = 0;
+  
+  // 刚有过通信就断开的链路与空闲超时无关，不调整间隔
+  if (idle < HEARTBEAT_MIN_INTERVAL_MS) return;
+  
+  // 记住失效时的空闲时长作为上限，之后放宽间隔都不会越过它
+  unsigned long target = idle * 3 / 4;
+  if (target < HEARTBEAT_MIN_INTERVAL_MS) {
+    target = HEARTBEAT_MIN_INTERVAL_MS;
+  }
+  if (target > HEARTBEAT_MAX_INTERVAL_MS) {
+    target = HEARTBEAT_MAX_INTERVAL_MS;
+  }
+  heartbeat_ceiling = target;
+  heartbeat_ceiling_since = millis();
+  
+  if (heartbeat_interval > heartbeat_ceiling) {
+    heartbeat_interval = heartbeat_ceiling;
+    Serial.println("💓 Heartbeat interval tightened to " + String(heartbeat_interval / 1000) + " s");
+  }
+}
+
+// 丢弃当前TCP连接，由心跳调度在WiFi可用时立即重连（不计入链路失效统计）
+void requestServerReconnect() {
+  server_was_connected = false;
+  awaiting_ack = false;
+  client.stop();
+  server_reconnect_now = true;
+}
+
+// 心跳调度：发送流量推迟心跳，接收流量只推迟NAT保活，应答超时立即重连
+void handleKeepalive() {
+  if (WiFi.status() != WL_CONNECTED) return;
+  
+  unsigned long now = millis();
+  
+  // TCP 连接已断开（服务器主动关闭或尚未连上）
+  if (!client.connected()) {
+    if (server_was_connected) {
+      server_was_connected = false;
+      awaiting_ack = false;
+      // 服务器只看设备发送的间隔，据此判断是否为服务器空闲超时
+      noteLinkFailure(now - last_server_tx);
+      Serial.println("⚠️  Bemfa connection closed by peer");
+    }
+    if (server_reconnect_now) {
+      server_reconnect_now = false;
+      server_reconnect_backoff = SERVER_RECONNECT_MIN_BACKOFF_MS;
+      connect_server();
+    } else if (now - last_server_reconnect >= server_reconnect_backoff) {
+      // 本次是重试，失败后下一次等待加倍
+      server_reconnect_backoff *= 2;
+      if (server_reconnect_backoff > SERVER_RECONNECT_MAX_BACKOFF_MS) {
+        server_reconnect_backoff = SERVER_RECONNECT_MAX_BACKOFF_MS;
+      }
+      connect_server();
+    }
+    return;
+  }
+  
+  // 服务器未在期限内应答：链路已死，不必等待看门狗
+  if (awaiting_ack && now - ack_sent_at > SERVER_ACK_TIMEOUT_MS) {
+    Serial.println("⚠️  No reply from Bemfa within " + String(SERVER_ACK_TIMEOUT_MS / 1000) + " s, reconnecting...");
+    awaiting_ack = false;
+    server_was_connected = false;
+    noteLinkFailure(ack_idle_before);
+    client.stop();
+    connect_server();
+    return;
+  }
+  
+  // 巴法云只认设备发送的流量，发送间隔必须始终低于服务器上限；
+  // 收到的数据只能刷新NAT映射，因此只推迟自适应的NAT保活心跳
+  unsigned long since_tx = now - last_server_tx;
+  unsigned long since_rx = now - last_server_rx;
+  unsigned long idle = (since_tx < since_rx) ? since_tx : since_rx;
+  if (!awaiting_ack && (since_tx >= HEARTBEAT_MAX_INTERVAL_MS || idle >= heartbeat_interval)) {
+    send_heartbeat();
+  }
+}
+
+// 探测主题名
+String getProbeTopic() {
+  return String(bafa_topic_buf) + LATENCY_PROBE_TOPIC_SUFFIX;
+}
+
+// 发送带时间戳的探测消息：msg=lp_<序号>_<millis>
+void sendLatencyProbe() {
+  if (!client.connected()) return;
+  
+  latency_probe_seq++;
+  String probe = "cmd=2&uid=" + String(bafa_uid_buf) + "&topic=" + getProbeTopic() +
+                 "&msg=lp_" + String(latency_probe_seq) + "_" + String(millis()) + "\r\n";
+  sendToServer(probe);
+}
+
+// 处理探测回显，返回 true 表示该消息属于延迟探测（不再作为开关指令解析）
+bool handleLatencyProbeEcho(const String& message) {
+  int idx = message.indexOf("msg=lp");
+  if (idx == -1) return false;
+  
+  // 统计消息（lps_）是自己发布的，直接忽略
+  const char* p = message.c_str() + idx + 6;
+  if (*p != '_') return true;
+  
+  char* end;
+  uint32_t seq = strtoul(p + 1, &end, 10);
+  if (*end != '_') return true;
+  unsigned long sent = strtoul(end + 1, NULL, 10);
+  
+  unsigned long rtt = millis() - sent;
+  // 丢弃重启前遗留或来源不明的探测
+  if (seq == 0 || seq > latency_probe_seq || rtt > 60000) {
+    Serial.println("⚠️  Ignoring stale latency probe #" + String(seq));
+    return true;
+  }
+  
+  histogramRecord(cloud_rtt_hist, rtt);
+  Serial.println("⏱️  Probe #" + String(seq) + " RTT: " + String(rtt) + " ms");
+  return true;
+}
+
+// 输出延迟统计摘要，开启探测时同时发布到探测主题
+void reportLatencyStats() {
+  printHistogramSummary(cloud_rtt_hist);
+  printHistogramSummary(dispatch_hist);
+  printHistogramSummary(rx_wait_hist);
+  printHistogramSummary(loop_gap_hist);
+  if (latency_probe_enabled) {
+    publishLatencyStats();
+  }
+}
+
+// 将延迟统计发布到探测主题：msg=lps_r<p50>-<p90>-<p99>-<max>_d<...>_w<...>（r=云端往返ms，d=处理us，w=等待读取ms）
+void publishLatencyStats() {
+  if (!client.connected()) return;
+  
+  String stats = "cmd=2&uid=" + String(bafa_uid_buf) + "&topic=" + getProbeTopic() + "&msg=lps_r" +
+                 String(histogramPercentile(cloud_rtt_hist, 50)) + "-" +
+                 String(histogramPercentile(cloud_rtt_hist, 90)) + "-" +
+                 String(histogramPercentile(cloud_rtt_hist, 99)) + "-" +
+                 String(cloud_rtt_hist.max) + "_d" +
+                 String(histogramPercentile(dispatch_hist, 50)) + "-" +
+                 String(histogramPercentile(dispatch_hist, 90)) + "-" +
+                 String(histogramPercentile(dispatch_hist, 99)) + "-" +
+                 String(dispatch_hist.max) + "_w" +
+                 String(histogramPercentile(rx_wait_hist, 50)) + "-" +
+                 String(histogramPercentile(rx_wait_hist, 90)) + "-" +
+                 String(histogramPercentile(rx_wait_hist, 99)) + "-" +
+                 String(rx_wait_hist.max) + "\r\n";
+  sendToServer(stats);
+}
+
+// 串口命令处理：stats / stats reset / probe on / probe off / wifi list / wifi add / wifi forget
+void handleSerialCommand() {
+  if (!Serial.available()) return;
+  
+  String cmd = Serial.readStringUntil('\n');
+  cmd.trim();
+  
+  if (cmd == "stats") {
+    printHistogram(cloud_rtt_hist);
+    printHistogram(dispatch_hist);
+    printHistogram(rx_wait_hist);
+    printHistogram(loop_gap_hist);
+    printHistogram(reconnect_hist);
+  } else if (cmd == "stats reset") {
+    histogramReset(cloud_rtt_hist);
+    histogramReset(dispatch_hist);
+    histogramReset(rx_wait_hist);
+    histogramReset(loop_gap_hist);
+    histogramReset(reconnect_hist);
+    Serial.println("✅ Latency statistics cleared");
+  } else if (cmd == "probe on") {
+    if (!latency_probe_enabled) {
+      latency_probe_enabled = true;
+      // 追加订阅探测主题
+      if (client.connected()) {
+        sendToServer("cmd=1&uid=" + String(bafa_uid_buf) + "&topic=" + getProbeTopic() + "\r\n");
+      }
+    }
+    Serial.println("✅ Latency probe enabled on topic: " + getProbeTopic());
+  } else if (cmd == "probe off") {
+    latency_probe_enabled = false;
+    Serial.println("✅ Latency probe disabled");
+  } else if (cmd == "wifi list") {
+    printKnownAPs();
+  } else if (cmd.startsWith("wifi add ")) {
+    // wifi add <ssid> <password>，SSID 可含空格，以最后一个空格分隔密码
+    String args = cmd.substring(9);
+    int sep = args.lastIndexOf(' ');
+    String ssid = (sep > 0) ? args.substring(0, sep) : args;
+    String pass = (sep > 0) ? args.substring(sep + 1) : String();
+    rememberAP(ssid, pass, 0);
+    printKnownAPs();
+  } else if (cmd.startsWith("wifi forget ")) {
+    // toInt() 对非数字返回 0，必须先确认参数全是数字，避免误删第 0 个网络
+    String arg = cmd.substring(12);
+    bool numeric = (arg.length() > 0);
+    for (unsigned int i = 0; i < arg.length() && numeric; i++) {
+      numeric = isdigit((unsigned char)arg[i]);
+    }
+    int idx = numeric ? arg.toInt() : -1;
+    if (!numeric) {
+      Serial.println("❌ Usage: wifi forget <n>");
+    } else if (idx >= 0 && idx < known_ap_count) {
+      for (uint8_t i = idx; i + 1 < known_ap_count; i++) {
+        known_aps[i] = known_aps[i + 1];
+      }
+      known_ap_count--;
+      saveKnownAPs();
+    }
+    printKnownAPs();
+  } else if (cmd.length() > 0) {
+    Serial.println("❓ Unknown command: " + cmd);
+    Serial.println("   Available: stats, stats reset, probe on, probe off, wifi list, wifi add <ssid> <pass>, wifi forget <n>");
+  }
 }
 
 // 初始化BLE
@@ -645,26 +1382,22 @@ void initBLE() {
   
   Serial.println("Initializing BLE...");
   
-  // 设置自定义MAC地址（如果提供）
-  if (strlen(ble_mac_buf) > 0) {
-    uint8_t customMAC[6];
-    sscanf(ble_mac_buf, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", 
-           &customMAC[0], &customMAC[1], &customMAC[2], 
-           &customMAC[3], &customMAC[4], &customMAC[5]);
-    customMAC[5]=customMAC[5]-2;
-    if (esp_base_mac_addr_set(customMAC) == ESP_OK) {
-      Serial.println("Custom MAC address set successfully");
-    } else {
-      Serial.println("Failed to set custom MAC address");
+  // 设置自定义MAC地址（如果提供），否则使用默认MAC地址
+  uint8_t bleMAC[6];
+  if (!parseMACAddress(ble_mac_buf, strlen(ble_mac_buf), bleMAC)) {
+    if (strlen(ble_mac_buf) > 0) {
+      Serial.println("⚠️  Invalid BLE MAC '" + String(ble_mac_buf) + "', using default");
     }
+    memcpy(bleMAC, newMAC, sizeof(bleMAC));
+  }
+  
+  // 蓝牙MAC由基础MAC推导而来，需反推基础MAC
+  uint8_t baseMAC[6];
+  deriveBaseMACForBLE(bleMAC, baseMAC);
+  if (esp_base_mac_addr_set(baseMAC) == ESP_OK) {
+    Serial.println("Custom MAC address set successfully");
   } else {
-    // 使用默认MAC地址
-    newMAC[5] = newMAC[5]-2;
-    if (esp_base_mac_addr_set(newMAC) == ESP_OK) {
-      Serial.println("Custom MAC address set successfully");
-    } else {
-      Serial.println("Failed to set custom MAC address");
-    }
+    Serial.println("Failed to set custom MAC address");
   }
   
   // 打印使用的MAC地址
@@ -708,10 +1441,15 @@ void startBLEAdvertising() {
   BLEAdvertisementData oAdvertisementData = BLEAdvertisementData();
   
   // 检查是否有配置的广播数据，如果有则使用配置的数据，否则使用默认的wake_adv_data
-  if (strlen(ble_data_buf) > 0) {
+  uint8_t advData[HEX_DATA_MAX_BYTES];
+  int advLen = decodeHexData(ble_data_buf, strlen(ble_data_buf), advData, sizeof(advData));
+  if (advLen < 0) {
+    Serial.println("⚠️  Invalid BLE data '" + String(ble_data_buf) + "', using predefined data");
+  }
+  
+  if (advLen > 0) {
     // 使用配置的十六进制字符串数据
-    std::string hexData = hexToBytes(String(ble_data_buf));
-    oAdvertisementData.addData(hexData);
+    oAdvertisementData.addData(std::string(reinterpret_cast<char*>(advData), advLen));
     Serial.println("BLE Beacon started with configured data: " + String(ble_data_buf));
   } else {
     // 使用预定义的wake_adv_data数组作为原始广播数据
@@ -747,12 +1485,62 @@ void handleBLEAdvertising() {
   }
 }
 
-// 将十六进制字符串转换为字节数组
-std::string hexToBytes(const String& hex) {
-  std::string result;
-  for (unsigned int i = 0; i < hex.length(); i += 2) {
-    std::string byte = hex.substring(i, i+2).c_str();
-    result.push_back((char) strtol(byte.c_str(), NULL, 16));
+// 记录一个延迟样本
+void histogramRecord(LatencyHistogram& h, uint32_t value) {
+  uint8_t bucket = (value == 0) ? 0 : (32 - __builtin_clz(value));
+  if (bucket >= LATENCY_HIST_BUCKETS) {
+    bucket = LATENCY_HIST_BUCKETS - 1;
+  }
+  
+  h.buckets[bucket]++;
+  h.count++;
+  if (value > h.max) {
+    h.max = value;
+  }
+}
+
+// 计算百分位数（返回所在桶的上界，不超过最大值）
+uint32_t histogramPercentile(const LatencyHistogram& h, uint8_t pct) {
+  if (h.count == 0) return 0;
+  
+  uint32_t rank = ((uint64_t)h.count * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < LATENCY_HIST_BUCKETS - 1; i++) {
+    seen += h.buckets[i];
+    if (seen >= rank) {
+      uint32_t upper = (i == 0) ? 0 : ((1UL << i) - 1);
+      return upper < h.max ? upper : h.max;
+    }
   }
-  return result;
-}
\ No newline at end of file
+  return h.max;
+}
+
+// 清空直方图
+void histogramReset(LatencyHistogram& h) {
+  memset(h.buckets, 0, sizeof(h.buckets));
+  h.count = 0;
+  h.max = 0;
+}
+
+// 打印完整直方图
+void printHistogram(const LatencyHistogram& h) {
+  Serial.println("📊 " + String(h.name) + " histogram (" + String(h.count) + " samples):");
+  printHistogramSummary(h);
+  
+  for (uint8_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+    if (h.buckets[i] == 0) continue;
+    uint32_t lo = (i == 0) ? 0 : (1UL << (i - 1));
+    String hi = (i == LATENCY_HIST_BUCKETS - 1) ? String("inf") : String((i == 0) ? 0UL : ((1UL << i) - 1));
+    Serial.println("   [" + String(lo) + ", " + hi + "] " + h.unit + ": " + String(h.buckets[i]));
+  }
+}
+
+// 打印一行百分位摘要
+void printHistogramSummary(const LatencyHistogram& h) {
+  if (h.count == 0) return;
+  Serial.println("   " + String(h.name) + " p50/p90/p99/max: " +
+                 String(histogramPercentile(h, 50)) + "/" +
+                 String(histogramPercentile(h, 90)) + "/" +
+                 String(histogramPercentile(h, 99)) + "/" +
+                 String(h.max) + " " + h.unit);
+}